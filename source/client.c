@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,17 +7,25 @@
 #include <arpa/inet.h>
 #include <stdbool.h>
 #include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "shm_ring.h"
 
 #define BUFFER_SIZE 1024  // Define buffer size for reading server response
 
 // Function prototypes
 void validate_argument_number(int argc);
-void parse_arguments(int argc, char *argv[], char **ip, char **port, char **filename, char **keyword);
-void validate_arguments(char **ip, char **port, char **filename, char **keyword);
+void parse_arguments(int argc, char *argv[], char **ip, char **port, char **filename, char **keyword, char **shm, char **count);
+void validate_arguments(char **ip, char **port, char **filename, char **keyword, char **shm, char **count);
 int is_valid_ip(const char *ip);
 int is_valid_port(const char *port);
 int is_valid_file(const char *filename);
 int is_valid_keyword (const char *keyword);
+int is_valid_count(const char *count);
 long get_file_size(FILE* file);
 char* read_file_content(FILE* file, long file_size);
 int create_client_fd();
@@ -24,19 +33,25 @@ void connect_server(char *port, char *ip, int client_fd);
 void send_message_to_server(int client_socket, const char* message, long size);
 void receive_server_response(int client_socket);
 void close_socket(int client_socket);
+int connect_shm_server(const char *path);
+struct shm_region *create_shm_region(int *region_fd);
+void send_shm_handshake(int control_fd, const char *keyword, const int fds[3]);
+bool exchange_shm_message(struct shm_region *region, const int fds[3], int control_fd,
+                          uint32_t *head, uint32_t *tail, const char *content, long size);
+void run_shm_session(const char *path, const char *keyword, const char *content, long size, long count);
 
 int main(int argc, char *argv[])
 {
-    char *ip = NULL, *port = NULL, *filename = NULL, *keyword = NULL;
+    char *ip = NULL, *port = NULL, *filename = NULL, *keyword = NULL, *shm = NULL, *count = NULL;
 
     // Validate the number of arguments passed to the program
     validate_argument_number(argc);
 
     // Parse command line arguments into variables for IP, port, filename, and keyword
-    parse_arguments(argc, argv, &ip, &port, &filename, &keyword);
+    parse_arguments(argc, argv, &ip, &port, &filename, &keyword, &shm, &count);
 
     // Validate the parsed arguments for correctness
-    validate_arguments(&ip, &port, &filename, &keyword);
+    validate_arguments(&ip, &port, &filename, &keyword, &shm, &count);
 
     // Open the specified file for reading
     FILE* file = fopen(filename, "r");
@@ -51,6 +66,16 @@ int main(int argc, char *argv[])
     // Read the file content into memory
     char* file_content = read_file_content(file, file_size);
 
+    // Same-host clients exchange the payload through shared-memory rings instead of TCP
+    if (shm != NULL)
+    {
+        run_shm_session(shm, keyword, file_content, file_size, count ? strtol(count, NULL, 10) : 1);
+
+        free(file_content);
+        fclose(file);
+        return 0;
+    }
+
     printf("Creating socket...\n");
 
     // Create a client socket for communication
@@ -86,15 +111,16 @@ int main(int argc, char *argv[])
 // Function to validate the number of command line arguments
 void validate_argument_number(int argc)
 {
-    if (argc != 9)  // Expecting 8 arguments, 1 for the program name
+    if (argc != 9 && argc != 7)  // Expecting 8 arguments, or 6 (8 with -n) with -shm, plus 1 for the program name
     {
         fprintf(stderr, "Usage: -ip <IP Address> -p <Port> -f <Filename> -key <Keyword>\n");
+        fprintf(stderr, "       -shm <Socket Path> -f <Filename> -key <Keyword> [-n <Count>]\n");
         exit(EXIT_FAILURE);
     }
 }
 
 // Function to parse command line arguments into variables
-void parse_arguments(int argc, char *argv[], char **ip, char **port, char **filename, char **keyword)
+void parse_arguments(int argc, char *argv[], char **ip, char **port, char **filename, char **keyword, char **shm, char **count)
 {
     for (int i = 1; i < argc; i++)
     {
@@ -114,32 +140,61 @@ void parse_arguments(int argc, char *argv[], char **ip, char **port, char **file
         {
             *keyword = argv[i + 1];
         }
+        else if (strcmp(argv[i], "-shm") == 0 && i + 1 < argc)
+        {
+            *shm = argv[i + 1];
+        }
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+        {
+            *count = argv[i + 1];
+        }
     }
 
-    // Check if any argument is missing
-    if (*ip == NULL || *port == NULL || *filename == NULL || *keyword == NULL)
+    // Check if any argument is missing; the shared-memory socket path replaces the IP and port
+    if ((*shm == NULL && (*ip == NULL || *port == NULL)) || *filename == NULL || *keyword == NULL)
     {
         fprintf(stderr, "Error: Missing or incorrect arguments.\n");
         fprintf(stderr, "Usage: -ip <IP Address> -p <Port> -f <Filename> -key <Keyword>\n");
+        fprintf(stderr, "       -shm <Socket Path> -f <Filename> -key <Keyword> [-n <Count>]\n");
         exit(EXIT_FAILURE);
     }
 }
 
 // Function to validate the command line arguments
-void validate_arguments (char **ip, char **port, char **filename, char **keyword)
+void validate_arguments (char **ip, char **port, char **filename, char **keyword, char **shm, char **count)
 {
-    // Validate IP Address format
-    if (*ip == NULL || !is_valid_ip(*ip))
+    if (*shm != NULL)
     {
-        fprintf(stderr, "Error: Invalid IP Address format. Expected format: xxx.xxx.xxx.xxx\n");
-        exit(EXIT_FAILURE);
-    }
+        // Validate the socket path fits in sockaddr_un
+        if (strlen(*shm) == 0 || strlen(*shm) >= sizeof(((struct sockaddr_un *)0)->sun_path))
+        {
+            fprintf(stderr, "Error: Invalid socket path. Must be between 1 and %zu characters.\n",
+                    sizeof(((struct sockaddr_un *)0)->sun_path) - 1);
+            exit(EXIT_FAILURE);
+        }
 
-    // Validate Port (should be a number between 1 and 65535)
-    if (*port == NULL || !is_valid_port(*port))
+        // Validate the message count (sent over one shared-memory session)
+        if (*count != NULL && !is_valid_count(*count))
+        {
+            fprintf(stderr, "Error: Invalid count. Must be a positive number.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    else
     {
-        fprintf(stderr, "Error: Invalid Port. Must be a number between 1 and 65535.\n");
-        exit(EXIT_FAILURE);
+        // Validate IP Address format
+        if (*ip == NULL || !is_valid_ip(*ip))
+        {
+            fprintf(stderr, "Error: Invalid IP Address format. Expected format: xxx.xxx.xxx.xxx\n");
+            exit(EXIT_FAILURE);
+        }
+
+        // Validate Port (should be a number between 1 and 65535)
+        if (*port == NULL || !is_valid_port(*port))
+        {
+            fprintf(stderr, "Error: Invalid Port. Must be a number between 1 and 65535.\n");
+            exit(EXIT_FAILURE);
+        }
     }
 
     // Validate Filename (it must not be empty and the file must exist and be non-empty)
@@ -220,6 +275,15 @@ int is_valid_keyword(const char *keyword)
     return 1;
 }
 
+// Function to validate the message count
+int is_valid_count(const char *count)
+{
+    char *endptr;
+    long count_num = strtol(count, &endptr, 10);
+
+    return *endptr == '\0' && count[0] != '\0' && count_num >= 1 && count_num < LONG_MAX;
+}
+
 // Function to get the size of the file
 long get_file_size(FILE* file) {
     fseek(file, 0, SEEK_END);
@@ -323,3 +387,176 @@ void receive_server_response(int client_socket) {
 void close_socket(int client_socket) {
     close(client_socket);
 }
+
+// Function to connect to the server's shared-memory control socket
+int connect_shm_server(const char *path)
+{
+    int control_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (control_fd == -1) {
+        perror("ERR: Socket creation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    if (connect(control_fd, (struct sockaddr *) &addr, sizeof(addr)) == -1) {
+        perror("Connection Failed");
+        exit(EXIT_FAILURE);
+    }
+    printf("Connected to the server over shared memory...\n");
+    return control_fd;
+}
+
+// Function to create and initialize the memfd region holding both rings
+struct shm_region *create_shm_region(int *region_fd) {
+    *region_fd = memfd_create("cipher-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+    if (*region_fd == -1) {
+        perror("ERR: memfd_create failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (ftruncate(*region_fd, sizeof(struct shm_region)) == -1) {
+        perror("ERR: ftruncate failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Seal the size so the server can map the region without risking SIGBUS from a later shrink
+    if (fcntl(*region_fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) == -1) {
+        perror("ERR: Sealing the region failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // A fresh memfd is zero-filled, so every ring index and sleep flag starts at 0
+    struct shm_region *region = mmap(NULL, sizeof(struct shm_region), PROT_READ | PROT_WRITE,
+                                     MAP_SHARED, *region_fd, 0);
+    if (region == MAP_FAILED) {
+        perror("ERR: mmap failed");
+        exit(EXIT_FAILURE);
+    }
+
+    region->magic = SHM_MAGIC;
+    region->slot_size = SHM_SLOT_SIZE;
+    region->slot_count = SHM_RING_SLOTS;
+    return region;
+}
+
+// Function to send the keyword together with the region and eventfd descriptors
+void send_shm_handshake(int control_fd, const char *keyword, const int fds[3]) {
+    struct iovec iov = {(void *) keyword, strlen(keyword)};
+    union {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+    memset(&control, 0, sizeof(control));
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cmsg), fds, 3 * sizeof(int));
+
+    if (sendmsg(control_fd, &msg, 0) == -1) {
+        perror("ERR: Failed to send handshake");
+        close_socket(control_fd);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Function to send one message through the request ring and print it as slots come back encrypted
+bool exchange_shm_message(struct shm_region *region, const int fds[3], int control_fd,
+                          uint32_t *head, uint32_t *tail, const char *content, long size) {
+    long offset = 0;
+    bool eof_sent = false, done = false;
+
+    while (!done) {
+        // Fill every free slot with the next chunk, then the zero-length end marker
+        uint32_t submitted = *head;
+        while (!eof_sent && *head - *tail < SHM_RING_SLOTS) {
+            struct shm_slot *slot = &region->slots[*head % SHM_RING_SLOTS];
+            long chunk = size - offset;
+            if (chunk > SHM_SLOT_SIZE)
+                chunk = SHM_SLOT_SIZE;
+
+            memcpy(slot->data, content + offset, chunk);
+            slot->len = chunk;
+            offset += chunk;
+            eof_sent = chunk == 0;
+
+            (*head)++;
+        }
+        if (*head != submitted)
+            shm_ring_publish(&region->request, *head, fds[1]);  // One publish for the whole batch
+
+        int ready = shm_ring_wait(&region->response, *tail, fds[2], control_fd);
+        if (ready <= 0) {
+            if (ready == -1)
+                perror("ERR: Receiving error");
+            printf("\nServer closed the connection.\n");
+            return false;
+        }
+
+        // Print every slot the server has encrypted; each one becomes free for the next chunk
+        uint32_t ready_head = atomic_load_explicit(&region->response.head, memory_order_acquire);
+        while (*tail != ready_head && *tail != *head && !done) {
+            struct shm_slot *slot = &region->slots[*tail % SHM_RING_SLOTS];
+            uint32_t len = slot->len;
+            if (len == 0)
+                done = true;
+            else
+                fwrite(slot->data, 1, len > SHM_SLOT_SIZE ? SHM_SLOT_SIZE : len, stdout);
+            (*tail)++;
+        }
+    }
+    return true;
+}
+
+// Function to send the file count times over one shared-memory session and report the round-trip time
+void run_shm_session(const char *path, const char *keyword, const char *content, long size, long count) {
+    int control_fd = connect_shm_server(path);
+
+    int fds[3];  // Region memfd, request eventfd (client -> server), response eventfd (server -> client)
+    struct shm_region *region = create_shm_region(&fds[0]);
+    fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (fds[1] == -1 || fds[2] == -1) {
+        perror("ERR: eventfd failed");
+        exit(EXIT_FAILURE);
+    }
+
+    send_shm_handshake(control_fd, keyword, fds);
+    printf("Message streaming to the server.\n\n");
+    printf("Encrypted message received from the server:\n");
+
+    uint32_t head = 0;  // Slots submitted on the request ring
+    uint32_t tail = 0;  // Slots consumed from the response ring
+    long sent = 0;
+    struct timespec start, end;
+
+    // The rings stay mapped between messages, so only the first one pays for the setup above
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (sent < count && exchange_shm_message(region, fds, control_fd, &head, &tail, content, size)) {
+        sent++;
+        if (sent < count)
+            putchar('\n');
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    printf("\nDisconnected from the server.\n");
+
+    if (sent > 0) {
+        double elapsed_us = (end.tv_sec - start.tv_sec) * 1e6 + (end.tv_nsec - start.tv_nsec) / 1e3;
+        printf("Average round trip: %.2f us over %ld message(s).\n", elapsed_us / sent, sent);
+    }
+
+    munmap(region, sizeof(struct shm_region));
+    for (int i = 0; i < 3; i++)
+        close(fds[i]);
+    close_socket(control_fd);
+}
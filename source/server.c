@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -6,37 +7,54 @@
 #include <stdbool.h>
 #include <ctype.h>
 #include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include "shm_ring.h"
 
 #define BUFFER_SIZE 1024  // Buffer size for data transfer
 #define BACKLOG 10        // Max number of pending connections in the server's queue
 
 static int server_fd = -1; // Global server socket file descriptor
+static int shm_listen_fd = -1; // Global shared-memory control socket file descriptor
+static const char *shm_path = NULL; // Path of the shared-memory control socket
+static struct stat shm_path_stat; // Identity of the socket inode this process bound at shm_path
 
 // Function declarations
 void validate_argument_number(int argc);
-void parse_arguments(int argc, char *argv[], char **ip, char **port);
-void validate_arguments(char **ip, char **port);
+void parse_arguments(int argc, char *argv[], char **ip, char **port, char **shm);
+void validate_arguments(char **ip, char **port, char **shm);
 int is_valid_ip(const char *ip);
 int is_valid_port(const char *port);
 void handle_signal(int signal);
 int create_server_fd();
 void config_server(const char *ip, const char *port, int server_fd);
+int create_shm_listener(const char *path);
 void accept_client_connections(int server_socket);
 void process_client_message(int client_socket);
-void vigenere_cipher(char *text, const char *key);
+int receive_shm_handshake(int control_socket, char *keyword, int fds[3]);
+int prepare_shm_eventfd(int fd);
+void process_shm_client(int control_socket);
+void vigenere_cipher(char *text, size_t len, const char *key);
+int normalize_key(const char *key, char *key_upper);
+void vigenere_encrypt(char *text, size_t len, const char *key_upper, int valid_key_len, size_t *key_index);
 void cleanup();
 
 int main(int argc, char *argv[])
 {
-    char *ip = NULL, *port = NULL;
+    char *ip = NULL, *port = NULL, *shm = NULL;
     validate_argument_number(argc);  // Validate the number of arguments passed
-    parse_arguments(argc, argv, &ip, &port);  // Parse the arguments for IP and Port
-    validate_arguments(&ip, &port);  // Validate the IP and Port
+    parse_arguments(argc, argv, &ip, &port, &shm);  // Parse the arguments for IP, Port and optional socket path
+    validate_arguments(&ip, &port, &shm);  // Validate the IP, Port and socket path
 
     printf("IP Address: %s\n", ip);
     printf("Port: %s\n", port);
 
     signal(SIGINT, handle_signal);
+    signal(SIGCHLD, SIG_IGN);  // Shared-memory sessions run in children; let the kernel reap them
 
     // Create the server socket
     printf("Creating socket...\n");
@@ -46,6 +64,13 @@ int main(int argc, char *argv[])
     // Configure the server with the provided IP and port
     config_server(ip, port, server_fd);
 
+    // Optionally accept same-host clients on the shared-memory transport as well
+    if (shm != NULL)
+    {
+        shm_path = shm;
+        shm_listen_fd = create_shm_listener(shm_path);
+    }
+
     // Accept client connections in a loop
     accept_client_connections(server_fd);
 
@@ -55,15 +80,15 @@ int main(int argc, char *argv[])
 // Function to validate the number of arguments passed to the program
 void validate_argument_number(int argc)
 {
-    if (argc != 5)  // Expecting 5 arguments
+    if (argc != 5 && argc != 7)  // Expecting 5 arguments, or 7 with the shared-memory socket path
     {
-        fprintf(stderr, "Usage: -ip <IP Address> -p <Port>\n");
+        fprintf(stderr, "Usage: -ip <IP Address> -p <Port> [-shm <Socket Path>]\n");
         exit(EXIT_FAILURE);
     }
 }
 
 // Function to parse the arguments to extract the IP address and Port
-void parse_arguments(int argc, char *argv[], char **ip, char **port)
+void parse_arguments(int argc, char *argv[], char **ip, char **port, char **shm)
 {
     for (int i = 1; i < argc; i++)
     {
@@ -75,19 +100,23 @@ void parse_arguments(int argc, char *argv[], char **ip, char **port)
         {
             *port = argv[i + 1];  // Set the Port
         }
+        else if (strcmp(argv[i], "-shm") == 0 && i + 1 < argc)
+        {
+            *shm = argv[i + 1];  // Set the shared-memory control socket path
+        }
     }
 
     // If either IP or Port is missing or incorrect, print an error message and exit
     if (*ip == NULL || *port == NULL)
     {
         fprintf(stderr, "Error: Missing or incorrect arguments.\n");
-        fprintf(stderr, "Usage: -ip <IP Address> -p <Port>\n");
+        fprintf(stderr, "Usage: -ip <IP Address> -p <Port> [-shm <Socket Path>]\n");
         exit(EXIT_FAILURE);
     }
 }
 
-// Function to validate the IP address and Port
-void validate_arguments(char **ip, char **port)
+// Function to validate the IP address, Port and optional socket path
+void validate_arguments(char **ip, char **port, char **shm)
 {
     if (*ip == NULL || !is_valid_ip(*ip))  // Check if IP address is valid
     {
@@ -100,6 +129,14 @@ void validate_arguments(char **ip, char **port)
         fprintf(stderr, "Error: Invalid Port. Must be a number between 1 and 65535.\n");
         exit(EXIT_FAILURE);
     }
+
+    // Check the socket path fits in sockaddr_un
+    if (*shm != NULL && (strlen(*shm) == 0 || strlen(*shm) >= sizeof(((struct sockaddr_un *)0)->sun_path)))
+    {
+        fprintf(stderr, "Error: Invalid socket path. Must be between 1 and %zu characters.\n",
+                sizeof(((struct sockaddr_un *)0)->sun_path) - 1);
+        exit(EXIT_FAILURE);
+    }
 }
 
 // Function to check if the provided IP address is valid
@@ -173,6 +210,54 @@ void config_server(const char *ip, const char *port, int server_fd)
     }
 }
 
+// Function to create the Unix socket used for the shared-memory handshake
+int create_shm_listener(const char *path)
+{
+    int listen_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);  // Message-oriented, so the handshake arrives whole
+    if (listen_fd == -1)
+    {
+        perror("ERR: Shared-memory socket creation failed");
+        exit(EXIT_FAILURE);
+    }
+
+    struct sockaddr_un addr = {0};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    // Remove a stale socket left by a previous run, but never anything else at that path
+    struct stat st;
+    if (lstat(path, &st) == 0)
+    {
+        if (!S_ISSOCK(st.st_mode))
+        {
+            fprintf(stderr, "Shared-memory binding failed: %s exists and is not a socket\n", path);
+            exit(EXIT_FAILURE);
+        }
+        unlink(path);
+    }
+
+    printf("Binding shared-memory transport to: %s\n", path);
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1)
+    {
+        perror("Shared-memory binding failed");
+        exit(EXIT_FAILURE);
+    }
+
+    // Remember which inode we created so cleanup() only removes our own socket
+    if (lstat(path, &shm_path_stat) == -1)
+    {
+        perror("Shared-memory binding failed");
+        exit(EXIT_FAILURE);
+    }
+
+    if (listen(listen_fd, BACKLOG) == -1)
+    {
+        perror("Shared-memory listen error");
+        exit(EXIT_FAILURE);
+    }
+    return listen_fd;
+}
+
 // Function to accept client connections and process them
 void accept_client_connections(int server_socket)
 {
@@ -180,6 +265,51 @@ void accept_client_connections(int server_socket)
     {
         printf("Waiting for a client...\n");
 
+        // Wait on the TCP listener and, when enabled, the shared-memory listener
+        struct pollfd fds[2] = {{server_socket, POLLIN, 0}, {shm_listen_fd, POLLIN, 0}};
+        nfds_t nfds = shm_listen_fd != -1 ? 2 : 1;
+        if (poll(fds, nfds, -1) == -1)
+        {
+            perror("ERR: Poll failed");
+            continue;
+        }
+
+        if (nfds == 2 && (fds[1].revents & POLLIN))
+        {
+            int control_socket = accept(shm_listen_fd, NULL, NULL);  // Accept a shared-memory client
+            if (control_socket == -1)
+            {
+                perror("ERR: Accept failed");
+            }
+            else
+            {
+                printf("Shared-memory client connected.\n");
+                fflush(stdout);  // Keep buffered output from being duplicated in the child
+
+                // A session lasts until the client disconnects, so serve it in a child process
+                pid_t pid = fork();
+                if (pid == 0)
+                {
+                    close(server_fd);
+                    server_fd = -1;
+                    close(shm_listen_fd);
+                    shm_listen_fd = -1;  // Only the parent removes the socket file on shutdown
+
+                    process_shm_client(control_socket);  // Serve the client's rings until it disconnects
+
+                    close(control_socket);
+                    printf("Client disconnected.\n\n");
+                    exit(EXIT_SUCCESS);
+                }
+                if (pid == -1)
+                    perror("ERR: Fork failed");
+                close(control_socket);
+            }
+        }
+
+        if (!(fds[0].revents & POLLIN))
+            continue;
+
         int client_socket = accept(server_socket, NULL, NULL);  // Accept a client connection
         if (client_socket == -1)
         {
@@ -261,7 +391,7 @@ void process_client_message(int client_socket)
             printf("Key received from client: %s\n", keyword);
 
             // Encrypt the message using the Vigenère cipher
-            vigenere_cipher(message, keyword);
+            vigenere_cipher(message, message_len, keyword);
 
             // Send the encrypted message back to the client, handling partial sends
             ssize_t total_sent = 0;
@@ -293,14 +423,213 @@ void process_client_message(int client_socket)
     }
 }
 
-// Function to encrypt the text using the Vigenère cipher
-void vigenere_cipher(char *text, const char *key)
+// Function to receive the keyword and the region/eventfd descriptors from a shared-memory client
+int receive_shm_handshake(int control_socket, char *keyword, int fds[3])
 {
-    int text_len = strlen(text);  // Get the length of the text
-    int key_len = strlen(key);    // Get the length of the key
+    struct iovec iov = {keyword, BUFFER_SIZE - 1};
+    union
+    {
+        char buf[CMSG_SPACE(3 * sizeof(int))];
+        struct cmsghdr align;
+    } control;
+
+    struct msghdr msg = {0};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control.buf;
+    msg.msg_controllen = sizeof(control.buf);
+
+    ssize_t bytes_read = recvmsg(control_socket, &msg, MSG_CMSG_CLOEXEC);
+    if (bytes_read == -1)
+    {
+        perror("recvmsg error");
+        return -1;
+    }
+    keyword[bytes_read] = '\0';  // Null-terminate the keyword
+
+    // Expect exactly one SCM_RIGHTS message carrying the region memfd, request eventfd and response eventfd
+    struct cmsghdr *rights = NULL;
+    int rights_messages = 0;
+    size_t received = 0;
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+        {
+            rights = cmsg;
+            rights_messages++;
+            received = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        }
+    }
+
+    if (rights_messages == 1 && received == 3 && bytes_read > 0 && !(msg.msg_flags & (MSG_TRUNC | MSG_CTRUNC)))
+    {
+        memcpy(fds, CMSG_DATA(rights), 3 * sizeof(int));
+        return 0;
+    }
+
+    // Reject the handshake, closing every descriptor the kernel installed for us
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS)
+            continue;
+
+        size_t count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        for (size_t i = 0; i < count; i++)
+        {
+            int fd;
+            memcpy(&fd, CMSG_DATA(cmsg) + i * sizeof(int), sizeof(int));
+            close(fd);
+        }
+    }
+    return -1;
+}
+
+// Function to check a client-supplied descriptor is an eventfd and make our writes to it non-blocking
+int prepare_shm_eventfd(int fd)
+{
+    char link_path[64], target[64];
+    snprintf(link_path, sizeof(link_path), "/proc/self/fd/%d", fd);
+
+    ssize_t len = readlink(link_path, target, sizeof(target) - 1);
+    if (len == -1)
+        return -1;
+    target[len] = '\0';
+    if (strcmp(target, "anon_inode:[eventfd]") != 0)
+        return -1;
+
+    // A blocking eventfd with a full counter would stall shm_ring_publish() forever
+    int flags = fcntl(fd, F_GETFL);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1)
+        return -1;
+    return 0;
+}
+
+// Function to serve a shared-memory client: encrypt each request slot in place and hand it back,
+// message after message, until the client disconnects
+void process_shm_client(int control_socket)
+{
+    char keyword[BUFFER_SIZE] = {0};  // Buffer for storing the keyword (Vigenère cipher key)
+    int fds[3];  // Region memfd, request eventfd (client -> server), response eventfd (server -> client)
+
+    if (receive_shm_handshake(control_socket, keyword, fds) == -1)
+    {
+        printf("Error receiving shared-memory handshake.\n");
+        return;
+    }
+
+    // Map the client's region, refusing anything that can shrink, is too small or differs from our layout
+    struct stat st;
+    struct shm_region *region = MAP_FAILED;
+    int seals = fcntl(fds[0], F_GET_SEALS);
+    if (prepare_shm_eventfd(fds[1]) == -1 || prepare_shm_eventfd(fds[2]) == -1)
+    {
+        printf("Error: shared-memory wake-up descriptors are not eventfds.\n");
+    }
+    else if (seals == -1 || !(seals & F_SEAL_SHRINK))
+    {
+        printf("Error: shared-memory region is not sealed against shrinking.\n");
+    }
+    else if (fstat(fds[0], &st) == -1 || st.st_size < (off_t)sizeof(struct shm_region))
+    {
+        printf("Error: shared-memory region is too small.\n");
+    }
+    else
+    {
+        region = mmap(NULL, sizeof(struct shm_region), PROT_READ | PROT_WRITE, MAP_SHARED, fds[0], 0);
+        if (region == MAP_FAILED)
+            perror("mmap failed");
+        else if (region->magic != SHM_MAGIC || region->slot_size != SHM_SLOT_SIZE ||
+                 region->slot_count != SHM_RING_SLOTS)
+        {
+            printf("Error: shared-memory region has an unexpected layout.\n");
+            munmap(region, sizeof(struct shm_region));
+            region = MAP_FAILED;
+        }
+    }
+
+    char *key_upper = malloc(strlen(keyword) + 1);
+    if (region != MAP_FAILED && key_upper)
+    {
+        printf("Key received from client: %s\n", keyword);
+
+        int valid_key_len = normalize_key(keyword, key_upper);
+        size_t key_index = 0;  // Carries the key position across the slots of one message
+        size_t total_bytes = 0, pending_bytes = 0, messages = 0;
+        uint32_t tail = 0;  // Request ring consumer index, private to the server
+        int overrun = 0;
+
+        // Keep serving messages on the same rings until the client closes the control socket
+        while (shm_ring_wait(&region->request, tail, fds[1], control_socket) == 1)
+        {
+            uint32_t head = atomic_load_explicit(&region->request.head, memory_order_acquire);
+            if (head - tail > SHM_RING_SLOTS)
+            {
+                printf("Error: client overran the request ring.\n");
+                overrun = 1;
+                break;
+            }
 
+            while (tail != head)
+            {
+                struct shm_slot *slot = &region->slots[tail % SHM_RING_SLOTS];
+                uint32_t len = *(volatile uint32_t *)&slot->len;  // Read once; the client can still write it
+                if (len > SHM_SLOT_SIZE)
+                    len = SHM_SLOT_SIZE;
+
+                if (len == 0)
+                {
+                    // End-of-message marker: the next message starts from the beginning of the key
+                    messages++;
+                    key_index = 0;
+                    pending_bytes = 0;
+                }
+                else
+                {
+                    vigenere_encrypt(slot->data, len, key_upper, valid_key_len, &key_index);
+                    pending_bytes += len;
+                    total_bytes += len;
+                }
+                tail++;
+            }
+
+            shm_ring_publish(&region->response, tail, fds[2]);  // Return the whole batch to the client
+        }
+
+        printf("Encrypted %zu messages (%zu bytes) in shared memory for client.\n", messages, total_bytes);
+        if (pending_bytes > 0 && !overrun)
+            printf("Error: shared-memory client left before the end of the message.\n");
+    }
+    else if (!key_upper)
+    {
+        perror("malloc failed");
+    }
+
+    free(key_upper);
+    if (region != MAP_FAILED)
+        munmap(region, sizeof(struct shm_region));
+    for (int i = 0; i < 3; i++)
+        close(fds[i]);
+}
+
+// Function to encrypt len bytes of text using the Vigenère cipher
+void vigenere_cipher(char *text, size_t len, const char *key)
+{
     // Normalize the key to uppercase (ignore non-alphabetic characters)
-    char *key_upper = malloc(key_len + 1);
+    char *key_upper = malloc(strlen(key) + 1);
+    if (!key_upper)
+        return;
+    int valid_key_len = normalize_key(key, key_upper);
+
+    size_t key_index = 0;
+    vigenere_encrypt(text, len, key_upper, valid_key_len, &key_index);
+
+    free(key_upper);  // Free the dynamically allocated memory for the key
+}
+
+// Function to normalize the key to uppercase letters, returning the number of valid key characters
+int normalize_key(const char *key, char *key_upper)
+{
+    int key_len = strlen(key);    // Get the length of the key
     int valid_key_len = 0;
     for (int i = 0; i < key_len; i++)
     {
@@ -310,15 +639,17 @@ void vigenere_cipher(char *text, const char *key)
         }
     }
     key_upper[valid_key_len] = '\0';  // Null-terminate the key
+    return valid_key_len;
+}
 
-    if (valid_key_len == 0)  // If the key is invalid (empty), free the key buffer and return
-    {
-        free(key_upper);
+// Function to encrypt len bytes of text, continuing from key position *key_index
+void vigenere_encrypt(char *text, size_t len, const char *key_upper, int valid_key_len, size_t *key_index)
+{
+    if (valid_key_len == 0)  // If the key is invalid (empty), leave the text unchanged
         return;
-    }
 
-    // Encrypt the text using the Vigenère cipher
-    for (int i = 0, j = 0; i < text_len; i++)
+    size_t j = *key_index;
+    for (size_t i = 0; i < len; i++)
     {
         if (isupper(text[i]))  // Encrypt uppercase letters
         {
@@ -331,8 +662,7 @@ void vigenere_cipher(char *text, const char *key)
             j++;  // Increment the key index
         }
     }
-
-    free(key_upper);  // Free the dynamically allocated memory for the key
+    *key_index = j;
 }
 
 // Cleanup server resources
@@ -342,4 +672,16 @@ void cleanup() {
         server_fd = -1;
         printf("Server socket closed.\n");
     }
+
+    if (shm_listen_fd != -1) {
+        close(shm_listen_fd);
+        shm_listen_fd = -1;
+
+        // Remove the socket file so the next run can bind, unless something else replaced it
+        struct stat st;
+        if (lstat(shm_path, &st) == 0 && S_ISSOCK(st.st_mode) &&
+            st.st_dev == shm_path_stat.st_dev && st.st_ino == shm_path_stat.st_ino)
+            unlink(shm_path);
+        printf("Shared-memory socket closed.\n");
+    }
 }
\ No newline at end of file
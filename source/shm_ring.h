@@ -0,0 +1,128 @@
+#ifndef SHM_RING_H
+#define SHM_RING_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+
+#define SHM_MAGIC 0x53484D31u   // "SHM1", written by the client once the region is initialized
+#define SHM_RING_SLOTS 64       // Number of payload slots shared by the request and response rings
+#define SHM_SLOT_SIZE 4096      // Max payload bytes carried by one slot
+#define SHM_SPIN_LIMIT 2048     // Ring polls before a consumer falls back to sleeping on its eventfd (multi-CPU only)
+#define SHM_CACHE_LINE 64       // Keeps the ring head and the sleep flag on separate cache lines
+
+#if defined(__x86_64__) || defined(__i386__)
+#define shm_cpu_relax() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define shm_cpu_relax() __asm__ __volatile__("yield")
+#else
+#define shm_cpu_relax() do {} while (0)
+#endif
+
+// Single-producer/single-consumer ring. Only the producer's head is shared; each consumer keeps
+// its tail privately. Entry n of either ring lives in slot n % SHM_RING_SLOTS, so the server
+// encrypts a request in place and returns ownership of that slot by publishing it on the
+// response ring. The client reuses a slot only after consuming it there, which bounds both rings.
+struct shm_ring
+{
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t head;               // Written by the producer only
+    _Alignas(SHM_CACHE_LINE) _Atomic uint32_t consumer_sleeping;  // Set while the consumer is blocked on its eventfd
+};
+
+// One payload chunk; a zero length marks the end of the message
+struct shm_slot
+{
+    uint32_t len;
+    char data[SHM_SLOT_SIZE];
+};
+
+// Layout of the memfd region mapped by both client and server
+struct shm_region
+{
+    uint32_t magic;
+    uint32_t slot_size;
+    uint32_t slot_count;
+    struct shm_ring request;   // Client -> server
+    struct shm_ring response;  // Server -> client
+    struct shm_slot slots[SHM_RING_SLOTS];
+};
+
+// Number of ring polls before sleeping. On a single CPU spinning only delays the peer, so sleep at once.
+static inline int shm_spin_limit(void)
+{
+    static int limit = -1;
+    if (limit == -1)
+        limit = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? SHM_SPIN_LIMIT : 0;
+    return limit;
+}
+
+// Publish entries up to head and wake the consumer if it went to sleep
+static inline void shm_ring_publish(struct shm_ring *ring, uint32_t head, int event_fd)
+{
+    atomic_store_explicit(&ring->head, head, memory_order_release);
+    atomic_thread_fence(memory_order_seq_cst);  // Pairs with the fence in shm_ring_wait()
+
+    if (atomic_load_explicit(&ring->consumer_sleeping, memory_order_relaxed))
+    {
+        // The peer shares this eventfd and can clear O_NONBLOCK, so only write when the counter has room;
+        // a full counter already guarantees a wake-up
+        struct pollfd pfd = {event_fd, POLLOUT, 0};
+        if (poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLOUT))
+        {
+            uint64_t one = 1;
+            ssize_t written = write(event_fd, &one, sizeof(one));
+            (void) written;
+        }
+    }
+}
+
+// Wait until the ring holds entries past tail.
+// Returns 1 when entries are available, 0 if the peer closed the control socket, -1 on error.
+static inline int shm_ring_wait(struct shm_ring *ring, uint32_t tail, int event_fd, int control_fd)
+{
+    int spin_limit = shm_spin_limit();
+    while (1)
+    {
+        // Busy-poll first: under load the next entry usually lands within microseconds
+        for (int i = 0; i < spin_limit; i++)
+        {
+            if (atomic_load_explicit(&ring->head, memory_order_acquire) != tail)
+                return 1;
+            shm_cpu_relax();
+        }
+
+        // Announce the sleep, then re-check so a publish racing with us is not missed
+        atomic_store_explicit(&ring->consumer_sleeping, 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        if (atomic_load_explicit(&ring->head, memory_order_acquire) != tail)
+        {
+            atomic_store_explicit(&ring->consumer_sleeping, 0, memory_order_relaxed);
+            return 1;
+        }
+
+        struct pollfd fds[2] = {{event_fd, POLLIN, 0}, {control_fd, POLLIN, 0}};
+        int ready = poll(fds, 2, -1);
+        atomic_store_explicit(&ring->consumer_sleeping, 0, memory_order_relaxed);
+        if (ready == -1)
+        {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+
+        if (fds[0].revents & POLLIN)
+        {
+            uint64_t count;
+            ssize_t drained = read(event_fd, &count, sizeof(count));  // Reset the wake-up counter
+            (void) drained;
+        }
+
+        // Nothing is sent on the control socket after the handshake, so any event means the peer left
+        if (fds[1].revents && atomic_load_explicit(&ring->head, memory_order_acquire) == tail)
+            return 0;
+    }
+}
+
+#endif // SHM_RING_H